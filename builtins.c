@@ -0,0 +1,646 @@
+// builtins.c
+// Tawfeeq Mannan
+
+// C includes
+#define _POSIX_C_SOURCE 200809L  // needed for nanosleep()
+#include <string.h>     // strcmp, strlen, strchr, memcpy
+#include <stdio.h>      // vsnprintf, fflush
+#include <stdlib.h>     // strtol, strtod, malloc, free
+#include <stdarg.h>     // va_list, va_start, va_end
+#include <limits.h>     // INT_MAX
+#include <unistd.h>     // read, write, close, access
+#include <signal.h>     // sigaction, SIGINT
+#include <time.h>       // nanosleep
+#include <sys/stat.h>   // stat
+#include <errno.h>      // errno, EINTR
+
+// user includes
+#include "constants.h"
+#include "shellio.h"
+#include "externals.h"
+#include "builtins.h"
+
+// global vars
+extern int last_status;  // defined in externals.c
+
+typedef struct
+{
+    const char *name;
+    int (*run)(int argc, char **argv, int input_fd);  // returns exit status
+} Builtin;
+
+// output of the current builtin, written out once it finishes
+static struct
+{
+    int fd;
+    size_t len;
+    char buf[OUT_BUF_SIZE];
+} out;
+
+// builtin is running in a forked child, whose stdio buffers are stale
+// copies of the shell's
+static int in_child = 0;
+
+
+/**
+ * @brief Write all of the buffered builtin output to its file
+ */
+static void out_flush()
+{
+    size_t done = 0;
+    ssize_t n;
+
+    // anything printf'd by the shell so far has to come out first
+    if (out.fd == STDOUT_FILENO)
+        fflush(stdout);
+
+    while (done < out.len)
+    {
+        n = write(out.fd, out.buf + done, out.len - done);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n == -1)
+        {
+            perror("write() failed (builtin output)");
+            break;
+        }
+        done += n;
+    }
+    out.len = 0;
+}
+
+
+/**
+ * @brief Append bytes to the builtin output, flushing only when full
+ *
+ * @param s Bytes to append
+ * @param n Number of bytes
+ */
+static void out_write(const char *s, size_t n)
+{
+    size_t chunk;
+    while (n > 0)
+    {
+        if (out.len == OUT_BUF_SIZE)
+            out_flush();
+        chunk = OUT_BUF_SIZE - out.len;
+        if (chunk > n)
+            chunk = n;
+        memcpy(out.buf + out.len, s, chunk);
+        out.len += chunk;
+        s += chunk;
+        n -= chunk;
+    }
+}
+
+
+/**
+ * @brief Append a C string to the builtin output
+ *
+ * @param s C string to append
+ */
+static void out_puts(const char *s)
+{
+    out_write(s, strlen(s));
+}
+
+
+/**
+ * @brief Append printf-style formatted text to the builtin output,
+ *        however long it turns out to be
+ *
+ * @param spec Format string for a single conversion
+ * @param ... Value for the conversion
+ */
+static void out_printf(const char *spec, ...)
+{
+    char conv[LINE_LENGTH];
+    char *big;
+    va_list ap;
+    int n;
+
+    va_start(ap, spec);
+    n = vsnprintf(conv, sizeof(conv), spec, ap);
+    va_end(ap);
+    if (n < 0)
+        return;
+    if ((size_t) n < sizeof(conv))
+    {
+        out_write(conv, n);
+        return;
+    }
+
+    // didn't fit (eg. a wide field), so format it again at its full size
+    big = malloc(n + 1);
+    if (big == NULL)
+    {
+        perror("malloc() failed (printf output)");
+        return;
+    }
+    va_start(ap, spec);
+    vsnprintf(big, n + 1, spec, ap);
+    va_end(ap);
+    out_write(big, n);
+    free(big);
+}
+
+
+/**
+ * @brief Parse a whole C string as an integer
+ *
+ * @param s C string to parse
+ * @param value Where to store the result
+ *
+ * @return True on success, False if s isn't an integer
+ */
+static int parse_int(const char *s, long *value)
+{
+    char *end;
+    errno = 0;
+    *value = strtol(s, &end, 10);
+    return (*s != '\0' && *end == '\0' && errno == 0);
+}
+
+
+/**
+ * @brief echo [-n] [words...]
+ *        Print the words separated by spaces, then a newline unless -n.
+ *
+ * @param argc Number of args, including the command name
+ * @param argv Null-terminated array of strings containing command & all args
+ * @param input_fd File descriptor of input file
+ *
+ * @return Exit status
+ */
+static int run_echo(int argc, char **argv, int input_fd)
+{
+    int newline = 1, first = 1;
+
+    if (argc > 1 && strcmp(argv[1], "-n") == 0)
+    {
+        newline = 0;
+        first++;
+    }
+    for (int i = first; i < argc; i++)
+    {
+        if (i > first)
+            out_write(" ", 1);
+        out_puts(argv[i]);
+    }
+    if (newline)
+        out_write("\n", 1);
+    return 0;
+}
+
+
+/**
+ * @brief printf FORMAT [args...]
+ *        Supports \n, \t, \\ escapes and %s, %d, %i, %c, %% conversions with
+ *        flags/width/precision. The format is reused until all args are used.
+ *
+ * @param argc Number of args, including the command name
+ * @param argv Null-terminated array of strings containing command & all args
+ * @param input_fd File descriptor of input file
+ *
+ * @return Exit status
+ */
+static int run_printf(int argc, char **argv, int input_fd)
+{
+    const char *fmt, *p;
+    char spec[MAX_LENGTH];
+    int arg = 2, status = 0;
+    size_t spec_len;
+    long num;
+
+    if (argc < 2)
+    {
+        log_error_msg(EC_BAD_ARG);
+        return 1;
+    }
+    fmt = argv[1];
+
+    do
+    {
+        for (p = fmt; *p != '\0'; p++)
+        {
+            if (*p == '\\' && p[1] != '\0')
+            {
+                p++;
+                if (*p == 'n')
+                    out_write("\n", 1);
+                else if (*p == 't')
+                    out_write("\t", 1);
+                else if (*p == '\\')
+                    out_write("\\", 1);
+                else
+                    out_write(p - 1, 2);  // not an escape we know
+                continue;
+            }
+            if (*p != '%')
+            {
+                out_write(p, 1);
+                continue;
+            }
+            if (p[1] == '%')
+            {
+                out_write("%", 1);
+                p++;
+                continue;
+            }
+
+            // copy "%[flags][width][.precision]" and find the conversion
+            spec_len = 0;
+            spec[spec_len++] = *p++;
+            while (*p != '\0' && strchr("-+ #0123456789.", *p) != NULL &&
+                   spec_len < MAX_LENGTH - 3)
+                spec[spec_len++] = *p++;
+
+            const char *value = (arg < argc) ? argv[arg++] : "";
+            if (*p == 's')
+            {
+                spec[spec_len++] = 's';
+                spec[spec_len] = '\0';
+                out_printf(spec, value);
+            }
+            else if (*p == 'd' || *p == 'i')
+            {
+                if (*value == '\0')
+                    num = 0;
+                else if (!parse_int(value, &num))
+                {
+                    log_error_msg(EC_BAD_ARG);
+                    num = 0;
+                    status = 1;
+                }
+                spec[spec_len++] = 'l';
+                spec[spec_len++] = 'd';
+                spec[spec_len] = '\0';
+                out_printf(spec, num);
+            }
+            else if (*p == 'c')
+            {
+                spec[spec_len++] = 'c';
+                spec[spec_len] = '\0';
+                out_printf(spec, *value);
+            }
+            else
+            {
+                log_error_msg(EC_BAD_ARG);
+                return 1;
+            }
+        }
+    } while (arg > 2 && arg < argc);  // only reuse if the format took args
+
+    return status;
+}
+
+
+/**
+ * @brief Evaluate a test expression
+ *
+ * @param argc Number of words in the expression
+ * @param argv Words of the expression
+ *
+ * @return 0 if true, 1 if false, 2 if the expression is invalid
+ */
+static int eval_test(int argc, char **argv)
+{
+    struct stat st;
+    long lhs, rhs;
+    int rc;
+
+    if (argc == 0)
+        return 1;
+
+    if (strcmp(argv[0], "!") == 0 && argc > 1)
+    {
+        rc = eval_test(argc - 1, argv + 1);
+        return (rc == 2) ? 2 : !rc;
+    }
+
+    if (argc == 1)
+        return (argv[0][0] != '\0') ? 0 : 1;
+
+    if (argc == 2)
+    {
+        const char *op = argv[0], *arg = argv[1];
+        if (strcmp(op, "-n") == 0)
+            return (arg[0] != '\0') ? 0 : 1;
+        if (strcmp(op, "-z") == 0)
+            return (arg[0] == '\0') ? 0 : 1;
+        if (strcmp(op, "-r") == 0)
+            return (access(arg, R_OK) == 0) ? 0 : 1;
+        if (strcmp(op, "-w") == 0)
+            return (access(arg, W_OK) == 0) ? 0 : 1;
+        if (strcmp(op, "-x") == 0)
+            return (access(arg, X_OK) == 0) ? 0 : 1;
+
+        rc = stat(arg, &st);
+        if (strcmp(op, "-e") == 0)
+            return (rc == 0) ? 0 : 1;
+        if (strcmp(op, "-f") == 0)
+            return (rc == 0 && S_ISREG(st.st_mode)) ? 0 : 1;
+        if (strcmp(op, "-d") == 0)
+            return (rc == 0 && S_ISDIR(st.st_mode)) ? 0 : 1;
+        if (strcmp(op, "-s") == 0)
+            return (rc == 0 && st.st_size > 0) ? 0 : 1;
+        return 2;
+    }
+
+    if (argc == 3)
+    {
+        const char *op = argv[1];
+        if (strcmp(op, "=") == 0)
+            return (strcmp(argv[0], argv[2]) == 0) ? 0 : 1;
+        if (strcmp(op, "!=") == 0)
+            return (strcmp(argv[0], argv[2]) != 0) ? 0 : 1;
+
+        if (!parse_int(argv[0], &lhs) || !parse_int(argv[2], &rhs))
+            return 2;
+        if (strcmp(op, "-eq") == 0)
+            return (lhs == rhs) ? 0 : 1;
+        if (strcmp(op, "-ne") == 0)
+            return (lhs != rhs) ? 0 : 1;
+        if (strcmp(op, "-lt") == 0)
+            return (lhs < rhs) ? 0 : 1;
+        if (strcmp(op, "-le") == 0)
+            return (lhs <= rhs) ? 0 : 1;
+        if (strcmp(op, "-gt") == 0)
+            return (lhs > rhs) ? 0 : 1;
+        if (strcmp(op, "-ge") == 0)
+            return (lhs >= rhs) ? 0 : 1;
+    }
+
+    return 2;
+}
+
+
+/**
+ * @brief test EXPR, or [ EXPR ]
+ *
+ * @param argc Number of args, including the command name
+ * @param argv Null-terminated array of strings containing command & all args
+ * @param input_fd File descriptor of input file
+ *
+ * @return 0 if EXPR is true, 1 if false, 2 if invalid
+ */
+static int run_test(int argc, char **argv, int input_fd)
+{
+    int rc;
+
+    if (strcmp(argv[0], "[") == 0)
+    {
+        if (strcmp(argv[argc - 1], "]") != 0)
+        {
+            log_error_msg(EC_BAD_ARG);
+            return 2;
+        }
+        argc--;  // drop the closing bracket
+    }
+
+    rc = eval_test(argc - 1, argv + 1);
+    if (rc == 2)
+        log_error_msg(EC_BAD_ARG);
+    return rc;
+}
+
+
+/**
+ * @brief true. Always succeeds.
+ *
+ * @param argc Number of args, including the command name
+ * @param argv Null-terminated array of strings containing command & all args
+ * @param input_fd File descriptor of input file
+ *
+ * @return Exit status
+ */
+static int run_true(int argc, char **argv, int input_fd)
+{
+    return 0;
+}
+
+
+/**
+ * @brief false. Always fails.
+ *
+ * @param argc Number of args, including the command name
+ * @param argv Null-terminated array of strings containing command & all args
+ * @param input_fd File descriptor of input file
+ *
+ * @return Exit status
+ */
+static int run_false(int argc, char **argv, int input_fd)
+{
+    return 1;
+}
+
+
+/**
+ * @brief Does nothing, but lets a C-c interrupt nanosleep()
+ *
+ * @param signum Signal number (always SIGINT)
+ */
+static void interrupt_sleep(int signum)
+{
+}
+
+
+/**
+ * @brief sleep SECONDS
+ *        Seconds may be fractional. C-c cuts the sleep short.
+ *
+ * @param argc Number of args, including the command name
+ * @param argv Null-terminated array of strings containing command & all args
+ * @param input_fd File descriptor of input file
+ *
+ * @return Exit status
+ */
+static int run_sleep(int argc, char **argv, int input_fd)
+{
+    struct sigaction sa, old_sa;
+    struct timespec ts;
+    char *end;
+    double secs;
+    int rc;
+
+    if (argc < 2)
+    {
+        log_error_msg(EC_BAD_ARG);
+        return 1;
+    }
+    secs = strtod(argv[1], &end);
+    // also rules out inf and nan, which can't be converted to a time_t
+    if (end == argv[1] || *end != '\0' || !(secs >= 0 && secs <= INT_MAX))
+    {
+        log_error_msg(EC_BAD_ARG);
+        return 1;
+    }
+    ts.tv_sec = (time_t) secs;
+    ts.tv_nsec = (long) ((secs - ts.tv_sec) * 1e9);
+
+    // the shell ignores C-c, which would make this sleep uninterruptible.
+    // catch it for now, then put back whatever the shell had before
+    sa.sa_flags = 0;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = interrupt_sleep;
+    sigaction(SIGINT, &sa, &old_sa);
+    rc = nanosleep(&ts, NULL);
+    sigaction(SIGINT, &old_sa, NULL);
+
+    if (rc == 0)
+        return 0;
+    if (errno == EINTR)
+        return 128 + SIGINT;  // same convention as sh
+    perror("nanosleep() failed");
+    return 1;
+}
+
+
+/**
+ * @brief read
+ *        Consume one line of input. The shell has no variables to store it
+ *        in, so only the exit status is kept.
+ *
+ * @param argc Number of args, including the command name
+ * @param argv Null-terminated array of strings containing command & all args
+ * @param input_fd File descriptor of input file
+ *
+ * @return 0 if a line was read, 1 at end of input
+ */
+static int run_read(int argc, char **argv, int input_fd)
+{
+    int ch;
+    char c;
+    ssize_t n;
+
+    // the shell reads its own input thru stdio, so share that buffer.
+    // a child's copy of it is stale, so it has to go to the fd instead.
+    // either way, the whole line goes, however long it is
+    if (input_fd == STDIN_FILENO && !in_child)
+    {
+        while ((ch = getchar()) != EOF && ch != '\n')
+            ;
+        return (ch == '\n') ? 0 : 1;
+    }
+
+    // a byte at a time so nothing past the newline is consumed
+    while ((n = read(input_fd, &c, 1)) == 1 && c != '\n')
+        ;
+    return (n == 1) ? 0 : 1;
+}
+
+
+static const Builtin builtins[] =
+{
+    { "echo", run_echo },
+    { "printf", run_printf },
+    { "test", run_test },
+    { "[", run_test },
+    { "true", run_true },
+    { "false", run_false },
+    { "sleep", run_sleep },
+    { "read", run_read },
+};
+
+
+/**
+ * @brief Look up a fast-path builtin by name
+ *
+ * @param cmd Name of the command (argv[0])
+ *
+ * @return Matching builtin, or NULL if there isn't one
+ */
+static const Builtin *find_builtin(const char *cmd)
+{
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++)
+    {
+        if (strcmp(builtins[i].name, cmd) == 0)
+            return &builtins[i];
+    }
+    return NULL;
+}
+
+
+/**
+ * @brief Check whether a command is one of the fast-path builtins
+ *        (echo, printf, test, [, true, false, sleep, read)
+ *
+ * @param cmd Name of the command (argv[0])
+ *
+ * @return True if the shell runs this command itself, False otherwise
+ */
+int is_builtin(const char *cmd)
+{
+    return find_builtin(cmd) != NULL;
+}
+
+
+/**
+ * @brief Identify the IO redirects applied to a builtin and run it in the
+ *        shell process. Pipes and background execution need a child
+ *        process, so those go through parse_external_request() instead,
+ *        and the child runs the builtin in place of execve().
+ *
+ * Redirects go through parse_redirects(), same as for external commands.
+ *
+ * @param argc Number of input arguments (tokens)
+ * @param argv Array of strings containing input arguments
+ */
+void parse_builtin_request(int argc, char **argv)
+{
+    int infile_fd, outfile_fd;
+    int cmd_argc;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "|") == 0 || strcmp(argv[i], "&") == 0)
+        {
+            parse_external_request(argc, argv);
+            return;
+        }
+    }
+
+    cmd_argc = parse_redirects(argc, argv, &infile_fd, &outfile_fd);
+    argv[cmd_argc] = NULL;
+
+    last_status = run_builtin(cmd_argc, argv, infile_fd, outfile_fd, 0);
+
+    if (infile_fd != STDIN_FILENO && close(infile_fd) == -1)
+        perror("close() failed (input file)");
+    if (outfile_fd != STDOUT_FILENO && close(outfile_fd) == -1)
+        perror("close() failed (output file)");
+}
+
+
+/**
+ * @brief Run a fast-path builtin in the current process.
+ *
+ * All output is collected in a buffer owned by the shell and written once
+ * the builtin is done, so a builtin costs no fork() or execve() and
+ * usually a single write().
+ *
+ * @param argc Number of args (not counting redirects)
+ * @param argv Null-terminated array of strings containing command & all args
+ * @param input_fd File descriptor of input file
+ * @param output_fd File descriptor of output file
+ * @param is_child True if running in a forked child instead of the shell
+ *
+ * @return Exit status of the builtin
+ */
+int run_builtin(int argc,
+                char **argv,
+                int input_fd,
+                int output_fd,
+                int is_child)
+{
+    const Builtin *builtin = find_builtin(argv[0]);
+    int status;
+
+    in_child = is_child;
+    out.fd = output_fd;
+    out.len = 0;
+    status = builtin->run(argc, argv, input_fd);
+    out_flush();  // one write for the whole command
+
+    return status;
+}
@@ -0,0 +1,49 @@
+// builtins.h
+// Tawfeeq Mannan
+
+#ifndef _BUILTINS_H
+#define _BUILTINS_H
+
+
+/**
+ * @brief Check whether a command is one of the fast-path builtins
+ *        (echo, printf, test, [, true, false, sleep, read)
+ * 
+ * @param cmd Name of the command (argv[0])
+ * 
+ * @return True if the shell runs this command itself, False otherwise
+ */
+int is_builtin(const char *cmd);
+
+
+/**
+ * @brief Identify the IO redirects applied to a builtin and run it in the
+ *        shell process. Pipes and background execution go through
+ *        parse_external_request() instead, which runs it in a child.
+ * 
+ * @param argc Number of input arguments (tokens)
+ * @param argv Array of strings containing input arguments
+ */
+void parse_builtin_request(int argc, char **argv);
+
+
+/**
+ * @brief Run a fast-path builtin in the current process, writing its output
+ *        through a shell-owned buffer that is flushed once at the end.
+ * 
+ * @param argc Number of args (not counting redirects)
+ * @param argv Null-terminated array of strings containing command & all args
+ * @param input_fd File descriptor of input file
+ * @param output_fd File descriptor of output file
+ * @param is_child True if running in a forked child instead of the shell
+ * 
+ * @return Exit status of the builtin
+ */
+int run_builtin(int argc,
+                char **argv,
+                int input_fd,
+                int output_fd,
+                int is_child);
+
+
+#endif  // _BUILTINS_H
@@ -8,6 +8,17 @@
 #define MAX_ARGS 5  // num of args per command
 #define MAX_LENGTH 20  // num of characters per arg
 #define MAX_BG_PROC 1  // num of background processes
+#define MAX_BG_JOBS (MAX_BG_PROC * 10)  // num of bg/stopped jobs tracked
+#define OUT_BUF_SIZE 4096  // bytes of builtin output buffered per command
+#define MAX_COPROCS 4  // num of coprocesses running at once
+#define COPROC_BUF_SIZE 4096  // bytes of coprocess output held by the shell
+#define COPROC_TIMEOUT_MS 5000  // how long to wait on a silent coprocess
+#define SERVE_WORKERS 4  // default num of concurrent serve-mode sessions
+#define SERVE_BACKLOG 64  // num of pending connections on the serve socket
+#define SERVE_RECORD_SIZE 4096  // max bytes of output per record to clients
+#define SERVE_STDOUT_TAG 'o'  // record tags in the serve-mode protocol
+#define SERVE_STDERR_TAG 'e'
+#define SERVE_STATUS_TAG 's'
 
 typedef enum
 {
@@ -15,6 +26,17 @@ typedef enum
     EC_CD_NO_ARGS,
     EC_CD_PATH_NOT_FOUND,
     EC_UNKNOWN_CMD,
+    EC_TOO_MANY_JOBS,
+    EC_SERVE_USAGE,
+    EC_BAD_ARG,
+    EC_COPROC_NO_ARGS,
+    EC_COPROC_NAME_LENGTH,
+    EC_COPROC_EXISTS,
+    EC_COPROC_NOT_FOUND,
+    EC_COPROC_LIMIT,
+    EC_COPROC_FULL,
+    EC_COPROC_TIMEOUT,
+    EC_COPROC_CLOSED,
 } ErrCode;
 
 #endif  // _CONSTANTS_H
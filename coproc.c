@@ -0,0 +1,399 @@
+// coproc.c
+// Tawfeeq Mannan
+
+// C includes
+#define _XOPEN_SOURCE 700   // needed for killpg() and poll()
+#include <string.h>     // strcmp, strcpy, strlen, memchr, memmove
+#include <stdio.h>      // fwrite, putchar, perror
+#include <unistd.h>     // fork, pipe, close, read, write, setpgid
+#include <sys/types.h>  // pid_t, ssize_t
+#include <signal.h>     // killpg, SIGTERM
+#include <sys/wait.h>   // waitpid
+#include <fcntl.h>      // fcntl, FD_CLOEXEC, O_NONBLOCK
+#include <poll.h>       // poll
+#include <errno.h>      // errno, EAGAIN, EINTR, EACCES
+
+// user includes
+#include "constants.h"
+#include "shellio.h"
+#include "externals.h"
+#include "coproc.h"
+
+// global vars
+extern int last_status;  // defined in externals.c
+
+typedef struct
+{
+    char name[MAX_LENGTH];
+    pid_t pid;  // 0 if this slot is free
+    int to_fd;  // write end of the coprocess's stdin
+    int from_fd;  // read end of the coprocess's stdout
+    char buf[COPROC_BUF_SIZE];  // output read from the coprocess, not yet used
+    size_t len;
+    int eof;  // coprocess has closed its stdout
+} Coproc;
+
+static Coproc coprocs[MAX_COPROCS];
+
+
+/**
+ * @brief Find a running coprocess by name
+ *
+ * @param name Name of the coprocess
+ *
+ * @return Matching coprocess, or NULL if there isn't one
+ */
+static Coproc *find_coproc(const char *name)
+{
+    for (int i = 0; i < MAX_COPROCS; i++)
+    {
+        if (coprocs[i].pid != 0 && strcmp(coprocs[i].name, name) == 0)
+            return &coprocs[i];
+    }
+    return NULL;
+}
+
+
+/**
+ * @brief Close a coprocess's pipes, terminate it, and free its slot
+ *
+ * @param c Coprocess to close
+ */
+static void close_coproc(Coproc *c)
+{
+    close(c->to_fd);
+    close(c->from_fd);
+    // closing stdin is usually enough, but don't rely on the program
+    if (killpg(c->pid, SIGTERM) == -1)
+        perror("killpg() failed (terminating coprocess)");
+    else if (waitpid(c->pid, NULL, 0) == -1)
+        perror("waitpid() failed (waiting for coprocess to die)");
+    c->pid = 0;
+}
+
+
+/**
+ * @brief Read whatever output a coprocess has ready into its buffer,
+ *        without blocking. Stops early if the buffer fills up.
+ *
+ * @param c Coprocess to read from
+ */
+static void drain_coproc(Coproc *c)
+{
+    ssize_t n;
+    while (!c->eof && c->len < COPROC_BUF_SIZE)
+    {
+        n = read(c->from_fd, c->buf + c->len, COPROC_BUF_SIZE - c->len);
+        if (n > 0)
+            c->len += n;
+        else if (n == 0)
+            c->eof = 1;
+        else
+        {
+            if (errno != EAGAIN && errno != EINTR)
+                perror("read() failed (coprocess output)");
+            return;
+        }
+    }
+}
+
+
+/**
+ * @brief Free a coprocess's slot if it has exited and all of its output
+ *        has been read, without blocking
+ *
+ * @param c Coprocess to check
+ */
+static void reap_coproc(Coproc *c)
+{
+    if (!c->eof || c->len > 0)
+        return;  // still running, or output left for coread
+    if (waitpid(c->pid, NULL, WNOHANG) == 0)
+        return;  // closed its stdout but hasn't exited yet
+
+    close(c->to_fd);
+    close(c->from_fd);
+    c->pid = 0;
+}
+
+
+/**
+ * @brief Launch a long-lived program whose stdin and stdout stay connected
+ *        to the shell, so later commands can talk to it by name.
+ *
+ * The shell's ends of the pipes are close-on-exec, so other commands never
+ * hold them open, and non-blocking, so the shell can't deadlock on them.
+ *
+ * @param name Name to refer to the coprocess by
+ * @param argv Null-terminated array of strings containing command & all args
+ */
+void start_coproc(const char *name, char **argv)
+{
+    Coproc *c = find_coproc(name);
+    int to_pipe[2], from_pipe[2];
+    pid_t pid;
+
+    if (strlen(name) >= MAX_LENGTH)
+    {
+        // it couldn't be stored whole, so it could never be found again
+        log_error_msg(EC_COPROC_NAME_LENGTH);
+        last_status = 1;
+        return;
+    }
+
+    if (c != NULL)
+    {
+        // it may have exited since the last prompt, so check again now
+        drain_coproc(c);
+        reap_coproc(c);
+        if (c->pid != 0)
+        {
+            log_error_msg(EC_COPROC_EXISTS);
+            last_status = 1;
+            return;
+        }
+        c = NULL;  // the name is free again, and so is its slot
+    }
+
+    for (int i = 0; i < MAX_COPROCS && c == NULL; i++)
+    {
+        if (coprocs[i].pid == 0)
+            c = &coprocs[i];
+    }
+    if (c == NULL)
+    {
+        log_error_msg(EC_COPROC_LIMIT);
+        last_status = 1;
+        return;
+    }
+
+    if (pipe(to_pipe) == -1)
+    {
+        perror("pipe() failed");
+        last_status = 1;
+        return;
+    }
+    if (pipe(from_pipe) == -1)
+    {
+        perror("pipe() failed");
+        close(to_pipe[0]);
+        close(to_pipe[1]);
+        last_status = 1;
+        return;
+    }
+
+    fflush(stdout);  // same as exec_program(), don't hand down our output
+    pid = fork();
+    if (pid == 0)
+    {
+        // child continues here. it only keeps its own ends of the pipes
+        close(to_pipe[1]);
+        close(from_pipe[0]);
+        // run it like a bg job so C-c/C-z at the prompt leave it alone
+        child_exec_cmd(argv, 0, 1, to_pipe[0], from_pipe[1]);
+        // child_exec_cmd() never returns so child is done now
+    }
+    else if (pid < 0)
+    {
+        perror("fork() failed");
+        close(to_pipe[0]);
+        close(to_pipe[1]);
+        close(from_pipe[0]);
+        close(from_pipe[1]);
+        last_status = 1;
+        return;
+    }
+
+    // parent continues here
+    if (setpgid(pid, pid) == -1 && errno != EACCES)
+        perror("setpgid() failed");
+    close(to_pipe[0]);
+    close(from_pipe[1]);
+    fcntl(to_pipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl(from_pipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(to_pipe[1], F_SETFL, O_NONBLOCK);
+    fcntl(from_pipe[0], F_SETFL, O_NONBLOCK);
+
+    strcpy(c->name, name);  // length was checked above
+    c->pid = pid;
+    c->to_fd = to_pipe[1];
+    c->from_fd = from_pipe[0];
+    c->len = 0;
+    c->eof = 0;
+}
+
+
+/**
+ * @brief Send a line of text to a coprocess's stdin
+ *
+ * While waiting for room in the coprocess's stdin, its output keeps getting
+ * drained too. Otherwise a coprocess blocked on a full stdout would never
+ * read its stdin, and both sides would wait on each other forever.
+ *
+ * @param name Name of the coprocess
+ * @param argc Number of words to send
+ * @param argv Words to send, joined by spaces
+ */
+void write_coproc(const char *name, int argc, char **argv)
+{
+    Coproc *c = find_coproc(name);
+    char line[LINE_LENGTH + 1];
+    size_t len = 0, sent = 0;
+    struct pollfd fds[2];
+    ssize_t n;
+
+    if (c == NULL)
+    {
+        log_error_msg(EC_COPROC_NOT_FOUND);
+        last_status = 1;
+        return;
+    }
+
+    // rebuild the line the user typed (all words fit since it came from one)
+    line[0] = '\0';
+    for (int i = 0; i < argc; i++)
+    {
+        if (i > 0)
+            line[len++] = ' ';
+        strcpy(line + len, argv[i]);
+        len += strlen(argv[i]);
+    }
+    line[len++] = '\n';
+
+    while (sent < len)
+    {
+        fds[0].fd = c->to_fd;
+        fds[0].events = POLLOUT;
+        // a negative fd is skipped by poll()
+        fds[1].fd = (c->eof || c->len == COPROC_BUF_SIZE) ? -1 : c->from_fd;
+        fds[1].events = POLLIN;
+
+        n = poll(fds, 2, COPROC_TIMEOUT_MS);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("poll() failed");
+            break;
+        }
+        else if (n == 0)
+        {
+            // stdin stayed full. if we can't drain stdout either, the
+            // coprocess is stuck waiting for someone to coread
+            if (c->len == COPROC_BUF_SIZE)
+                log_error_msg(EC_COPROC_FULL);
+            else
+                log_error_msg(EC_COPROC_TIMEOUT);
+            break;
+        }
+
+        if (fds[1].revents != 0)
+            drain_coproc(c);
+
+        if (fds[0].revents & (POLLERR | POLLHUP))
+        {
+            log_error_msg(EC_COPROC_CLOSED);
+            break;
+        }
+        else if (fds[0].revents & POLLOUT)
+        {
+            n = write(c->to_fd, line + sent, len - sent);
+            if (n > 0)
+                sent += n;
+            else if (n == -1 && errno != EAGAIN && errno != EINTR)
+            {
+                perror("write() failed (coprocess input)");
+                break;
+            }
+        }
+    }
+
+    if (sent < len)
+        last_status = 1;
+}
+
+
+/**
+ * @brief Print the next line of a coprocess's output, waiting for it
+ *        if necessary
+ *
+ * @param name Name of the coprocess
+ */
+void read_coproc(const char *name)
+{
+    Coproc *c = find_coproc(name);
+    struct pollfd pfd;
+    char *newline;
+    size_t line_len;
+
+    if (c == NULL)
+    {
+        log_error_msg(EC_COPROC_NOT_FOUND);
+        last_status = 1;
+        return;
+    }
+
+    while ((newline = memchr(c->buf, '\n', c->len)) == NULL)
+    {
+        if (c->eof || c->len == COPROC_BUF_SIZE)
+            break;  // no newline is ever coming, so hand back what we have
+
+        pfd.fd = c->from_fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, COPROC_TIMEOUT_MS) == 0)
+        {
+            log_error_msg(EC_COPROC_TIMEOUT);
+            last_status = 1;
+            return;
+        }
+        drain_coproc(c);
+    }
+
+    if (c->len == 0)
+    {
+        log_error_msg(EC_COPROC_CLOSED);
+        last_status = 1;
+        return;
+    }
+
+    line_len = (newline != NULL) ? (size_t) (newline - c->buf) + 1 : c->len;
+    fwrite(c->buf, 1, line_len, stdout);
+    if (newline == NULL)
+        putchar('\n');
+
+    // shift the rest of the output to the front of the buffer
+    c->len -= line_len;
+    memmove(c->buf, c->buf + line_len, c->len);
+}
+
+
+/**
+ * @brief Pull any pending output from every coprocess into the shell's
+ *        buffers without blocking, so no coprocess stalls on a full pipe.
+ *        Coprocesses that have exited and been fully read are reaped,
+ *        freeing their slots.
+ */
+void drain_coprocs()
+{
+    for (int i = 0; i < MAX_COPROCS; i++)
+    {
+        if (coprocs[i].pid != 0)
+        {
+            drain_coproc(&coprocs[i]);
+            reap_coproc(&coprocs[i]);
+        }
+    }
+}
+
+
+/**
+ * @brief Close all coprocesses and wait for them to terminate
+ */
+void close_coprocs()
+{
+    for (int i = 0; i < MAX_COPROCS; i++)
+    {
+        if (coprocs[i].pid != 0)
+            close_coproc(&coprocs[i]);
+    }
+}
@@ -0,0 +1,50 @@
+// coproc.h
+// Tawfeeq Mannan
+
+#ifndef _COPROC_H
+#define _COPROC_H
+
+
+/**
+ * @brief Launch a long-lived program whose stdin and stdout stay connected
+ *        to the shell, so later commands can talk to it by name.
+ * 
+ * @param name Name to refer to the coprocess by
+ * @param argv Null-terminated array of strings containing command & all args
+ */
+void start_coproc(const char *name, char **argv);
+
+
+/**
+ * @brief Send a line of text to a coprocess's stdin
+ * 
+ * @param name Name of the coprocess
+ * @param argc Number of words to send
+ * @param argv Words to send, joined by spaces
+ */
+void write_coproc(const char *name, int argc, char **argv);
+
+
+/**
+ * @brief Print the next line of a coprocess's output, waiting for it
+ *        if necessary
+ * 
+ * @param name Name of the coprocess
+ */
+void read_coproc(const char *name);
+
+
+/**
+ * @brief Pull any pending output from every coprocess into the shell's
+ *        buffers without blocking, so no coprocess stalls on a full pipe
+ */
+void drain_coprocs();
+
+
+/**
+ * @brief Close all coprocesses and wait for them to terminate
+ */
+void close_coprocs();
+
+
+#endif  // _COPROC_H
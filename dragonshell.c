@@ -2,14 +2,18 @@
 // Tawfeeq Mannan
 
 // C includes
-#include <string.h>     // memset
-#include <stdio.h>      // printf
-#include <signal.h>     // SIGINT, SIGTSTP, SIG_IGN
+#include <string.h>     // memset, strcmp
+#include <stdio.h>      // printf, setvbuf
+#include <stdlib.h>     // atoi
+#include <signal.h>     // SIGINT, SIGTSTP, SIGTTOU, SIGTTIN, SIGPIPE, SIG_IGN
 
 // user includes
 #include "constants.h"
 #include "shellio.h"
 #include "internals.h"
+#include "externals.h"
+#include "server.h"
+#include "coproc.h"
 
 
 /**
@@ -25,6 +29,28 @@ int main(int argc, char *argv[])
     char buffer[LINE_LENGTH];
     char *tokens[MAX_ARGS * 3];  // x3 for safety
     size_t token_cnt;
+    int workers = SERVE_WORKERS;
+
+    // a coprocess (or serve-mode client) that exits early must not take
+    // the shell down with it
+    assign_sighandler(SIGPIPE, SIG_IGN);
+
+    // dragonshell --serve SOCKET [--workers N] runs commands for local clients
+    if (argc >= 2 && strcmp(argv[1], "--serve") == 0)
+    {
+        if (argc == 5 && strcmp(argv[3], "--workers") == 0)
+            workers = atoi(argv[4]);
+        if ((argc != 3 && argc != 5) || workers < 1)
+        {
+            log_error_msg(EC_SERVE_USAGE);
+            return 1;
+        }
+        return serve(argv[2], workers);
+    }
+
+    // when stdout isn't a terminal it would be fully buffered, holding our
+    // output back until after that of the programs we launch
+    setvbuf(stdout, NULL, _IOLBF, 0);
 
     // display welcome message at start
     printf("Welcome to Dragon Shell!\n\n");
@@ -32,15 +58,22 @@ int main(int argc, char *argv[])
     // override signals for ctrl-C and ctrl-Z
     assign_sighandler(SIGINT, SIG_IGN);
     assign_sighandler(SIGTSTP, SIG_IGN);
-
+    // taking the terminal back from a job would otherwise stop the shell
+    assign_sighandler(SIGTTOU, SIG_IGN);
+    assign_sighandler(SIGTTIN, SIG_IGN);
+    init_job_control();
     while (1)
     {
         // wipe the buffer and arguments
         memset(buffer, 0, sizeof(buffer));
         memset(tokens, 0, sizeof(tokens));
 
-        // get a command from the user
-        display_prompt(buffer);
+        // keep coprocesses from stalling on output nobody has read yet
+        drain_coprocs();
+
+        // get a command from the user. end of input behaves like "exit"
+        if (!display_prompt(buffer))
+            exit_shell();
 
         // split the user-provided command into tokens for parsing
         token_cnt = tokenize(buffer, " ", tokens);
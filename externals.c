@@ -2,24 +2,28 @@
 // Tawfeeq Mannan
 
 // C includes
-#define _POSIX_SOURCE   // needed for kill()
+#define _POSIX_SOURCE   // needed for setpgid(), tcsetpgrp(), kill()
 #include <string.h>     // strcmp
 #include <stdio.h>      // printf
-#include <unistd.h>     // fork, execve, close, dup2, pipe
+#include <unistd.h>     // fork, execve, close, dup2, pipe, setpgid, tcsetpgrp
 #include <sys/types.h>  // pid_t
-#include <signal.h>     // SIGINT, SIGTSTP, SIG_DFL, kill
+#include <signal.h>     // SIGINT, SIGTSTP, SIGPIPE, SIG_DFL, kill
 #include <sys/wait.h>   // waitpid
-#include <fcntl.h>      // open
+#include <fcntl.h>      // open, fcntl
+#include <errno.h>      // errno, EACCES, ECHILD
 
 // user includes
 #include "constants.h"
 #include "shellio.h"
 #include "internals.h"
 #include "externals.h"
+#include "builtins.h"
 
 // global vars
-int num_bg_proc = 0;
-int bg_pids[MAX_BG_PROC * 10];
+int num_bg_jobs = 0;
+pid_t bg_pgids[MAX_BG_JOBS];  // one process group per job
+int tty_fd = -1;  // controlling terminal, if the shell may hand it to jobs
+int last_status = 0;  // exit status of the most recent command
 
 
 /**
@@ -31,39 +35,22 @@ int bg_pids[MAX_BG_PROC * 10];
 void parse_external_request(int argc, char **argv)
 {
     int is_bg_proc = (argc >= 2 && strcmp(argv[argc-1], "&") == 0);
-    char *infile, *outfile;
-    int infile_fd = STDIN_FILENO, outfile_fd = STDOUT_FILENO;
+    int infile_fd, outfile_fd;
     int pipe_ends[2];
     char **argv2 = NULL;
 
-    // iterate thru all "possibly sandwiched" args to look for in/out/pipe
+    if (is_bg_proc)
+    {
+        // need to set the final "&" to a NULL if it exists
+        argv[--argc] = NULL;
+    }
+
+    parse_redirects(argc, argv, &infile_fd, &outfile_fd);
+
+    // iterate thru the remaining "possibly sandwiched" args to look for a pipe
     for (int i = 1; i < argc-1; i++)
     {
-        if (strcmp(argv[i], "<") == 0)
-        {
-            // next argument is the input file. open it and assign a fd
-            infile = argv[i+1];
-            infile_fd = open(infile, O_RDONLY);
-            if (infile_fd == -1)
-            {
-                perror("open() failed (input redirect)");
-                infile_fd = STDIN_FILENO;
-            }
-            argv[i] = NULL;  // cut off the command args for exec_cmd
-        }
-        else if (strcmp(argv[i], ">") == 0)
-        {
-            // next argument is the output file. open it and assign a fd
-            outfile = argv[i+1];
-            outfile_fd = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-            if (outfile_fd == -1)
-            {
-                perror("open() failed (output redirect)");
-                outfile_fd = STDOUT_FILENO;
-            }
-            argv[i] = NULL;  // cut off the command args for exec_cmd
-        }
-        else if (strcmp(argv[i], "|") == 0)
+        if (argv[i] != NULL && strcmp(argv[i], "|") == 0)
         {
             // everything after this arg is the second command
             argv2 = argv + i + 1;
@@ -73,27 +60,90 @@ void parse_external_request(int argc, char **argv)
             }
             else
             {
+                // the pipe takes over both ends, so drop any redirects
+                if (infile_fd != STDIN_FILENO && close(infile_fd) == -1)
+                    perror("close() failed (input file)");
+                if (outfile_fd != STDOUT_FILENO && close(outfile_fd) == -1)
+                    perror("close() failed (output file)");
                 infile_fd = pipe_ends[0];
                 outfile_fd = pipe_ends[1];
             }
             argv[i] = NULL;  // cut off the command args for LHS
+            break;
         }
     }
 
-    if (is_bg_proc)
-    {
-        // need to set the final "&" to a NULL if it exists
-        argv[--argc] = NULL;
-    }
-
     // can pass same args regardless of pipe or not,
     // exec_program will decide how to handle fds accordingly based on argv2
     exec_program(argv, argv2, is_bg_proc, infile_fd, outfile_fd);
 }
 
 
+/**
+ * @brief Open the files named by the "<" and ">" redirects in a command and
+ *        cut them off its args. If a redirect is repeated, the last one wins.
+ *        Files that can't be opened are reported and left as stdin/stdout.
+ * 
+ * @param argc Number of input arguments (tokens)
+ * @param argv Array of strings containing input arguments.
+ *             Each redirect operator is replaced by a NULL.
+ * @param input_fd Set to the fd of the input file, or STDIN_FILENO
+ * @param output_fd Set to the fd of the output file, or STDOUT_FILENO
+ * 
+ * @return Number of args before the first redirect
+ */
+int parse_redirects(int argc, char **argv, int *input_fd, int *output_fd)
+{
+    int cmd_argc = argc;
+
+    *input_fd = STDIN_FILENO;
+    *output_fd = STDOUT_FILENO;
+
+    // iterate thru all "possibly sandwiched" args to look for in/out
+    for (int i = 1; i < argc-1; i++)
+    {
+        if (strcmp(argv[i], "<") == 0)
+        {
+            // next argument is the input file. open it and assign a fd
+            if (*input_fd != STDIN_FILENO)
+                close(*input_fd);
+            *input_fd = open(argv[i+1], O_RDONLY);
+            if (*input_fd == -1)
+            {
+                perror("open() failed (input redirect)");
+                *input_fd = STDIN_FILENO;
+            }
+        }
+        else if (strcmp(argv[i], ">") == 0)
+        {
+            // next argument is the output file. open it and assign a fd
+            if (*output_fd != STDOUT_FILENO)
+                close(*output_fd);
+            *output_fd = open(argv[i+1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (*output_fd == -1)
+            {
+                perror("open() failed (output redirect)");
+                *output_fd = STDOUT_FILENO;
+            }
+        }
+        else
+        {
+            continue;
+        }
+
+        argv[i] = NULL;  // cut off the command args for exec_cmd
+        if (i < cmd_argc)
+            cmd_argc = i;
+    }
+
+    return cmd_argc;
+}
+
+
 /**
  * @brief Execute an external program (or 2) as its own process.
+ *        All processes of the command share one process group (the job),
+ *        led by the first child, so the job is signaled as a whole.
  * 
  * @param argv Array of strings containing args (start with program filepath)
  * @param argv Array of strings containing second command args
@@ -108,8 +158,11 @@ void exec_program(char **argv,
                   int output_fd)
 {
     int is_pipe_case = (argv2 != NULL);
-    pid_t cpid1, cpid2;
+    int num_procs = 1;
+    pid_t cpid1, cpid2, pgid, last_pid;
 
+    // children must not inherit (and later flush) output we haven't written
+    fflush(stdout);
     cpid1 = fork();  // create child
     if (cpid1 == 0)
     {
@@ -120,7 +173,7 @@ void exec_program(char **argv,
                 perror("close() failed");
             input_fd = STDIN_FILENO;
         }
-        child_exec_cmd(argv, is_bg_proc, input_fd, output_fd);
+        child_exec_cmd(argv, 0, is_bg_proc, input_fd, output_fd);
         // child_exec_cmd() never returns so child is done now
     }
     else if (cpid1 < 0)
@@ -130,6 +183,14 @@ void exec_program(char **argv,
     }
 
     // parent continues here.
+    // set the group from both sides so it exists no matter who runs first.
+    // EACCES just means the child already did it and exec'd
+    pgid = last_pid = cpid1;
+    if (setpgid(cpid1, pgid) == -1 && errno != EACCES)
+        perror("setpgid() failed");
+    if (!is_bg_proc)
+        give_terminal_to(pgid);
+
     // should create another child for RHS if piping, otherwise skip to waiting
     if (is_pipe_case)
     {
@@ -140,25 +201,25 @@ void exec_program(char **argv,
             if (output_fd != STDOUT_FILENO && close(output_fd) == -1)
                 perror("close() failed");
             output_fd = STDOUT_FILENO;
-            child_exec_cmd(argv2, is_bg_proc, input_fd, output_fd);
+            child_exec_cmd(argv2, pgid, is_bg_proc, input_fd, output_fd);
             // child_exec_cmd() never returns so child2 is done now
         }
-        else if (cpid1 < 0)
+        else if (cpid2 < 0)
         {
+            // still need to collect child1, which sees the pipe close
             perror("fork() failed");
-            return;
         }
-
-        // parent continues here in the pipe case
-        // need to split close since we can't re-close the same fd twice
-        parent_wait_to_close(cpid1, is_bg_proc, STDIN_FILENO, output_fd);
-        parent_wait_to_close(cpid2, is_bg_proc, input_fd, STDOUT_FILENO);
+        else
+        {
+            if (setpgid(cpid2, pgid) == -1 && errno != EACCES)
+                perror("setpgid() failed");
+            last_pid = cpid2;
+            num_procs++;
+        }
     }
 
-    else  // parent continues here in non-pipe case
-    {
-        parent_wait_to_close(cpid1, is_bg_proc, input_fd, output_fd);
-    }
+    parent_wait_for_job(pgid, last_pid, num_procs,
+                        is_bg_proc, input_fd, output_fd);
 }
 
 
@@ -169,20 +230,32 @@ void exec_program(char **argv,
  * ! caller process will DIE after calling this, regardless of success/failure.
  * 
  * @param argv Null-terminated array of strings containing command & all args
+ * @param pgid Process group to join, or 0 to lead a new one
  * @param is_bg_proc True if process should run in background, False otherwise
  * @param input_fd File descriptor of input file
  * @param output_fd File descriptor of output file
  */
 void child_exec_cmd(char **argv,
+                    pid_t pgid,
                     int is_bg_proc,
                     int input_fd,
                     int output_fd)
 {
     char *envp[1] = { NULL };
+
+    if (setpgid(0, pgid) == -1)
+        perror("setpgid() failed");
+    // the shell ignores SIGPIPE, but programs expect to die from it
+    assign_sighandler(SIGPIPE, SIG_DFL);
     if (!is_bg_proc)
     {
+        // also grab the terminal here in case the parent hasn't yet.
+        // SIGTTOU is still ignored at this point so this can't stop us
+        give_terminal_to(getpgrp());
         assign_sighandler(SIGINT, SIG_DFL);
         assign_sighandler(SIGTSTP, SIG_DFL);
+        assign_sighandler(SIGTTOU, SIG_DFL);
+        assign_sighandler(SIGTTIN, SIG_DFL);
     }
 
     // redirect input to come from input file. no-op if infile == stdin
@@ -199,6 +272,15 @@ void child_exec_cmd(char **argv,
 
     // ! REMOVED: No longer need to redirect output to /dev/null
 
+    if (is_builtin(argv[0]))
+    {
+        // no need to exec anything, the child can run it directly
+        int argc = 0;
+        while (argv[argc] != NULL)
+            argc++;
+        _exit(run_builtin(argc, argv, STDIN_FILENO, STDOUT_FILENO, 1));
+    }
+
     // argv[0] will be ignored when passing args so can pass argv directly
     execve(argv[0], argv, envp);
     // execve returning means it failed. assume unknown command
@@ -208,45 +290,149 @@ void child_exec_cmd(char **argv,
 
 
 /**
- * @brief Wait for a given child to finish (if applicable), then
- *        clean up resources when the child has terminated.
+ * @brief Close the parent's copies of a job's files, then wait for every
+ *        process in the job to finish (if applicable).
+ * 
+ * The files are closed first so that a pipe's reader sees EOF once its
+ * writer exits, rather than waiting on the parent's copy of the write end.
  * 
- * @param pid Child's process ID
- * @param is_bg_proc True if parent should let child run in bg,
- *                   False if parent should wait for child to finish in fg
+ * @param pgid Job's process group ID
+ * @param last_pid Process at the end of the pipe, whose status is kept
+ * @param num_procs Number of processes in the job
+ * @param is_bg_proc True if parent should let the job run in bg,
+ *                   False if parent should wait for it to finish in fg
  * @param input_fd File descriptor of input file
  * @param output_fd File descriptor of output file
  */
-void parent_wait_to_close(pid_t pid,
-                          int is_bg_proc,
-                          int input_fd,
-                          int output_fd)
+void parent_wait_for_job(pid_t pgid,
+                         pid_t last_pid,
+                         int num_procs,
+                         int is_bg_proc,
+                         int input_fd,
+                         int output_fd)
 {
+    pid_t pid;
+    int status;
+
+    // the children hold their own copies now, so we can close ours
+    if (input_fd != STDIN_FILENO && close(input_fd) == -1)
+        perror("close() failed (input file)");
+    if (output_fd != STDOUT_FILENO && close(output_fd) == -1)
+        perror("close() failed (output file)");
+
     if (is_bg_proc)
     {
-        bg_pids[num_bg_proc++] = pid;
-        printf("PID %d is sent to background\n", pid);
+        if (add_bg_job(pgid))
+            printf("PID %d is sent to background\n", pgid);
+        last_status = 0;
+        return;
     }
 
-    else
+    // wait on the group rather than the pids, in case a bg job
+    // coincidentally finishes before the fg job
+    while (num_procs > 0)
     {
-        // wait for child to finish. use waitpid instead of wait in case a
-        // bg process coincidentally finishes before the fg process
-        if (waitpid(pid, NULL, WUNTRACED) == -1)
+        pid = waitpid(-pgid, &status, WUNTRACED);
+        if (pid == -1)
         {
             perror("waitpid() failed");
+            break;
         }
-        else if (kill(pid, 0) == 0)
+
+        if (WIFSTOPPED(status))
         {
-            // the child still exists, probably get here thru SIGTSTP
-            // we need to remember to kill this child manually at exit
-            bg_pids[num_bg_proc++] = pid;
+            // job was stopped (eg. by C-z), which stops the whole group.
+            // we need to remember to kill this job manually at exit
+            add_bg_job(pgid);
+            last_status = 128 + WSTOPSIG(status);
+            break;
         }
 
-        // since child is done now, we can close in/out files if necessary
-        if (input_fd != STDIN_FILENO && close(input_fd) == -1)
-            perror("close() failed (input file)");
-        if (output_fd != STDOUT_FILENO && close(output_fd) == -1)
-            perror("close() failed (output file)");
+        // like sh, the job's status is that of the end of the pipe
+        if (pid == last_pid && WIFEXITED(status))
+            last_status = WEXITSTATUS(status);
+        else if (pid == last_pid && WIFSIGNALED(status))
+            last_status = 128 + WTERMSIG(status);  // same convention as sh
+        num_procs--;
+    }
+
+    // job is done or stopped, so the shell takes the terminal back
+    give_terminal_to(getpgrp());
+}
+
+
+/**
+ * @brief Remember a bg or stopped job so exit_shell() can end it.
+ *        Jobs that have finished since are forgotten first to make room.
+ *        If there is still no room, the job is terminated right away.
+ * 
+ * @param pgid Job's process group ID
+ * 
+ * @return True if the job is being tracked, False if it was terminated
+ */
+int add_bg_job(pid_t pgid)
+{
+    int kept = 0;
+    pid_t pid;
+
+    // reap whatever finished. a job with nothing left to reap is done
+    for (int i = 0; i < num_bg_jobs; i++)
+    {
+        while ((pid = waitpid(-bg_pgids[i], NULL, WNOHANG)) > 0)
+            ;
+        if (pid == -1 && errno == ECHILD)
+            continue;  // drop it
+        bg_pgids[kept++] = bg_pgids[i];
+    }
+    num_bg_jobs = kept;
+
+    if (num_bg_jobs == MAX_BG_JOBS)
+    {
+        log_error_msg(EC_TOO_MANY_JOBS);
+        kill(-pgid, SIGCONT);  // in case it's stopped
+        if (kill(-pgid, SIGTERM) == -1)
+            perror("kill() failed (terminating job)");
+        while (waitpid(-pgid, NULL, 0) > 0)
+            ;
+        return 0;
     }
+
+    bg_pgids[num_bg_jobs++] = pgid;
+    return 1;
+}
+
+
+/**
+ * @brief Find the controlling terminal, if the shell is allowed to hand it
+ *        to jobs. That takes a terminal, and the shell being its foreground
+ *        group (ie. not started in the background). stdin doesn't have to
+ *        be the terminal, so scripts fed in with < or | still get C-c.
+ */
+void init_job_control()
+{
+    int fd = open("/dev/tty", O_RDWR);
+    if (fd == -1)
+        return;  // no controlling terminal, so nothing to hand over
+
+    if (tcgetpgrp(fd) != getpgrp())
+    {
+        close(fd);
+        return;
+    }
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);  // programs shouldn't inherit it
+    tty_fd = fd;
+}
+
+
+/**
+ * @brief Make a process group the terminal's foreground group, so it
+ *        receives C-c and C-z. No-op without job control.
+ * 
+ * @param pgid Process group to hand the terminal to
+ */
+void give_terminal_to(pid_t pgid)
+{
+    if (tty_fd != -1 && tcsetpgrp(tty_fd, pgid) == -1)
+        perror("tcsetpgrp() failed");
 }
@@ -16,8 +16,23 @@
 void parse_external_request(int argc, char **argv);
 
 
+/**
+ * @brief Open the files named by the "<" and ">" redirects in a command and
+ *        cut them off its args. If a redirect is repeated, the last one wins.
+ * 
+ * @param argc Number of input arguments (tokens)
+ * @param argv Array of strings containing input arguments
+ * @param input_fd Set to the fd of the input file, or STDIN_FILENO
+ * @param output_fd Set to the fd of the output file, or STDOUT_FILENO
+ * 
+ * @return Number of args before the first redirect
+ */
+int parse_redirects(int argc, char **argv, int *input_fd, int *output_fd);
+
+
 /**
  * @brief Execute an external program (or 2) as its own process.
+ *        All processes of the command share one process group (the job).
  * 
  * @param argv Array of strings containing args (start with program filepath)
  * @param argv Array of strings containing second command args
@@ -39,29 +54,62 @@ void exec_program(char **argv,
  * ! caller process will DIE after calling this, regardless of success/failure.
  * 
  * @param argv Null-terminated array of strings containing command & all args
+ * @param pgid Process group to join, or 0 to lead a new one
  * @param is_bg_proc True if process should run in background, False otherwise
  * @param input_fd File descriptor of input file
  * @param output_fd File descriptor of output file
  */
 void child_exec_cmd(char **argv,
+                    pid_t pgid,
                     int is_bg_proc,
                     int input_fd,
                     int output_fd);
 
 
 /**
- * @brief Wait for a given child to finish (if applicable), then
- *        clean up resources when the child has terminated.
+ * @brief Close the parent's copies of a job's files, then wait for every
+ *        process in the job to finish (if applicable).
  * 
- * @param pid Child's process ID
- * @param is_bg_proc True if child should run in background, False otherwise
+ * @param pgid Job's process group ID
+ * @param last_pid Process at the end of the pipe, whose status is kept
+ * @param num_procs Number of processes in the job
+ * @param is_bg_proc True if job should run in background, False otherwise
  * @param input_fd File descriptor of input file
  * @param output_fd File descriptor of output file
  */
-void parent_wait_to_close(pid_t pid,
-                          int is_bg_proc,
-                          int input_fd,
-                          int output_fd);
+void parent_wait_for_job(pid_t pgid,
+                         pid_t last_pid,
+                         int num_procs,
+                         int is_bg_proc,
+                         int input_fd,
+                         int output_fd);
+
+
+/**
+ * @brief Remember a bg or stopped job so exit_shell() can end it.
+ *        If there is no room left, the job is terminated instead.
+ * 
+ * @param pgid Job's process group ID
+ * 
+ * @return True if the job is being tracked, False if it was terminated
+ */
+int add_bg_job(pid_t pgid);
+
+
+/**
+ * @brief Find the controlling terminal, if the shell is its foreground
+ *        group, so jobs can be handed the terminal
+ */
+void init_job_control();
+
+
+/**
+ * @brief Make a process group the terminal's foreground group.
+ *        No-op without job control.
+ * 
+ * @param pgid Process group to hand the terminal to
+ */
+void give_terminal_to(pid_t pgid);
 
 
 #endif  // _EXTERNALS_H
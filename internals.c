@@ -2,12 +2,12 @@
 // Tawfeeq Mannan
 
 // C includes
-#define _POSIX_SOURCE   // needed for kill() to be declared
+#define _XOPEN_SOURCE 500  // needed for killpg() to be declared
 #include <string.h>     // strcmp
 #include <stdio.h>      // printf
 #include <stdlib.h>     // free
 #include <unistd.h>     // chdir, getcwd, _exit
-#include <signal.h>     // kill, sigaction
+#include <signal.h>     // killpg, sigaction
 #include <sys/wait.h>   // waitpid
 #include <sys/time.h>   // timeval
 #include <sys/resource.h>   // getrusage
@@ -17,10 +17,13 @@
 #include "shellio.h"
 #include "internals.h"
 #include "externals.h"
+#include "coproc.h"
+#include "builtins.h"
 
 // global vars
-extern int num_bg_proc;  // defined in externals.c
-extern int bg_pids[];
+extern int num_bg_jobs;  // defined in externals.c
+extern pid_t bg_pgids[];
+extern int last_status;
 
 
 /**
@@ -49,13 +52,18 @@ void assign_sighandler(int signum, void (*handler)(int))
  */
 void handle_request(int argc, char **argv)
 {
+    last_status = 0;  // builtins succeed unless they say otherwise
+
     if (argc == 0)  // empty line. no-op
         return;
 
     if (strcmp(argv[0], "cd") == 0)
     {
         if (argc < 2)
+        {
             log_error_msg(EC_CD_NO_ARGS);
+            last_status = 1;
+        }
         else
             change_dir(argv[1]);  // only needs argv[1]; ignore any after
     }
@@ -70,6 +78,44 @@ void handle_request(int argc, char **argv)
         exit_shell();
     }
 
+    else if (strcmp(argv[0], "coproc") == 0)
+    {
+        if (argc < 3)
+        {
+            log_error_msg(EC_COPROC_NO_ARGS);
+            last_status = 1;
+        }
+        else
+            start_coproc(argv[1], argv + 2);  // argv stays null-terminated
+    }
+
+    else if (strcmp(argv[0], "cowrite") == 0)
+    {
+        if (argc < 2)
+        {
+            log_error_msg(EC_COPROC_NO_ARGS);
+            last_status = 1;
+        }
+        else
+            write_coproc(argv[1], argc - 2, argv + 2);
+    }
+
+    else if (strcmp(argv[0], "coread") == 0)
+    {
+        if (argc < 2)
+        {
+            log_error_msg(EC_COPROC_NO_ARGS);
+            last_status = 1;
+        }
+        else
+            read_coproc(argv[1]);
+    }
+
+    else if (is_builtin(argv[0]))
+    {
+        parse_builtin_request(argc, argv);
+    }
+
     else  // assume external command
     {
         parse_external_request(argc, argv);
@@ -86,7 +132,10 @@ void change_dir(const char *target)
 {
     int rc = chdir(target);
     if (rc != 0)
+    {
         log_error_msg(EC_CD_PATH_NOT_FOUND);
+        last_status = 1;
+    }
         // no need to do anything if rc == 0; cd was successful
 }
 
@@ -106,22 +155,29 @@ void print_working_dir()
 
 /**
  * @brief Exit the shell gracefully.
- *        All background processes are terminated via SIGTERM.
+ *        All background jobs are terminated via SIGTERM, one signal per
+ *        process group regardless of how many processes it holds.
  */
 void exit_shell()
 {
-    // terminate any currently running bg processes
-    for (int i = 0; i < num_bg_proc; i++)
+    // coprocesses see EOF on their stdin and are terminated
+    close_coprocs();
+
+    // terminate any currently running bg jobs
+    for (int i = 0; i < num_bg_jobs; i++)
     {
         // in case it's stopped, need to wake up
-        if (kill(bg_pids[i], SIGCONT) == -1)
-            perror("kill() failed (waking up)");
-        // terminate the process gracefully
-        if (kill(bg_pids[i], SIGTERM) == -1)
-            perror("kill() failed (terminating children)");
-        // wait for the child to actually terminate before continuing
-        else if (waitpid(bg_pids[i], NULL, 0) == -1)
-            perror("waitpid() failed (waiting for child to die)");
+        if (killpg(bg_pgids[i], SIGCONT) == -1)
+            perror("killpg() failed (waking up)");
+        // terminate the whole job gracefully
+        if (killpg(bg_pgids[i], SIGTERM) == -1)
+        {
+            perror("killpg() failed (terminating children)");
+            continue;
+        }
+        // wait for every process in the job to actually terminate
+        while (waitpid(-bg_pgids[i], NULL, 0) > 0)
+            ;
     }
     
     // collect and display the child execution times
@@ -137,5 +193,6 @@ void exit_shell()
         printf("Sys time: %ld seconds\n", ru.ru_stime.tv_sec);
     }
 
+    fflush(stdout);  // _exit() skips flushing stdio buffers
     _exit(0);
 }
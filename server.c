@@ -0,0 +1,377 @@
+// server.c
+// Tawfeeq Mannan
+
+// C includes
+#define _POSIX_C_SOURCE 200809L  // needed for the socket api
+#include <string.h>     // memset, strlen, strcpy
+#include <stdio.h>      // printf, snprintf, setvbuf
+#include <unistd.h>     // fork, close, dup2, unlink, pipe, read, write
+#include <sys/types.h>  // pid_t
+#include <sys/socket.h> // socket, bind, listen, accept
+#include <sys/un.h>     // sockaddr_un
+#include <sys/wait.h>   // waitpid
+#include <fcntl.h>      // fcntl, FD_CLOEXEC, O_NONBLOCK
+#include <poll.h>       // poll
+#include <errno.h>      // errno, EAGAIN, EINTR
+
+// user includes
+#include "constants.h"
+#include "shellio.h"
+#include "internals.h"
+#include "coproc.h"
+#include "server.h"
+
+// global vars
+extern int last_status;  // defined in externals.c
+
+
+/**
+ * @brief Accept clients on a Unix domain socket and run their commands,
+ *        with at most max_workers sessions running at the same time.
+ * 
+ * Every session is forked into its own worker process, so cd and any other
+ * per-process state never leak between clients. Once the pool is full the
+ * server stops accepting until a worker exits; further clients wait in the
+ * listen backlog.
+ * 
+ * @param socket_path Filesystem path to bind the socket to
+ * @param max_workers Size of the session worker pool
+ * 
+ * @return Exit status (only returns if the socket could not be set up)
+ */
+int serve(const char *socket_path, int max_workers)
+{
+    int listen_fd, client_fd;
+    int num_workers = 0;
+    pid_t pid;
+
+    listen_fd = open_server_socket(socket_path);
+    if (listen_fd == -1)
+        return 1;
+
+    printf("Dragon Shell serving on %s with %d workers\n",
+           socket_path, max_workers);
+    fflush(stdout);  // don't let workers inherit the buffered message
+
+    while (1)
+    {
+        // reap any workers that finished since the last client arrived
+        while (num_workers > 0 && waitpid(-1, NULL, WNOHANG) > 0)
+            num_workers--;
+
+        if (num_workers >= max_workers)
+        {
+            // pool is full. block until a worker frees up
+            if (waitpid(-1, NULL, 0) > 0)
+                num_workers--;
+            else
+                perror("waitpid() failed (reaping worker)");
+            continue;
+        }
+
+        client_fd = accept(listen_fd, NULL, NULL);
+        if (client_fd == -1)
+        {
+            perror("accept() failed");
+            continue;
+        }
+
+        pid = fork();
+        if (pid == 0)
+        {
+            // worker continues here
+            close(listen_fd);
+            serve_session(client_fd);
+            // serve_session() never returns so worker is done now
+        }
+        else if (pid < 0)
+        {
+            perror("fork() failed");
+        }
+        else
+        {
+            num_workers++;
+        }
+
+        // the worker owns the connection now
+        close(client_fd);
+    }
+
+    return 1;  // should never be here
+}
+
+
+/**
+ * @brief Create, bind and listen on a Unix domain socket.
+ *        Any stale socket file at the path is removed first.
+ * 
+ * @param socket_path Filesystem path to bind the socket to
+ * 
+ * @return Listening socket fd, or -1 on failure
+ */
+int open_server_socket(const char *socket_path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path))
+    {
+        printf("dragonshell: Socket path is too long\n");
+        return -1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1)
+    {
+        perror("socket() failed");
+        return -1;
+    }
+
+    unlink(socket_path);  // ok to fail, there usually isn't a stale socket
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1)
+    {
+        perror("bind() failed");
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, SERVE_BACKLOG) == -1)
+    {
+        perror("listen() failed");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+
+/**
+ * @brief Run one client's session in a worker process.
+ * 
+ * The client sends one command per line. Everything written to the
+ * session's stdout and stderr goes through pipes to a relay process, which
+ * frames it for the client (see relay_session_output()). Once a command is
+ * done, its exit status is handed to the relay over a control pipe.
+ * 
+ * ! WARNING: This function never returns. The worker exits through
+ * ! exit_shell() once the client sends "exit" or closes its end.
+ * 
+ * @param client_fd Connected socket for this client
+ */
+void serve_session(int client_fd)
+{
+    char buffer[LINE_LENGTH];
+    char *tokens[MAX_ARGS * 3];  // x3 for safety
+    size_t token_cnt;
+    int out_pipe[2], err_pipe[2], ctl_pipe[2];
+    pid_t pid;
+
+    if (pipe(out_pipe) == -1 || pipe(err_pipe) == -1 || pipe(ctl_pipe) == -1)
+    {
+        perror("pipe() failed (session output)");
+        _exit(1);
+    }
+
+    pid = fork();
+    if (pid == 0)
+    {
+        // relay continues here. it only keeps the read ends and the socket
+        close(out_pipe[1]);
+        close(err_pipe[1]);
+        close(ctl_pipe[1]);
+        relay_session_output(client_fd, out_pipe[0], err_pipe[0], ctl_pipe[0]);
+        // relay_session_output() never returns so relay is done now
+    }
+    else if (pid < 0)
+    {
+        perror("fork() failed (session relay)");
+        _exit(1);
+    }
+
+    // session continues here. commands read from the client directly, but
+    // their output goes to the relay
+    if (dup2(client_fd, STDIN_FILENO) == -1 ||
+        dup2(out_pipe[1], STDOUT_FILENO) == -1 ||
+        dup2(err_pipe[1], STDERR_FILENO) == -1)
+    {
+        perror("dup2() failed (client socket)");
+        _exit(1);
+    }
+    close(client_fd);
+    close(out_pipe[0]);
+    close(out_pipe[1]);
+    close(err_pipe[0]);
+    close(err_pipe[1]);
+    close(ctl_pipe[0]);
+    // launched programs must not hold the control pipe open
+    fcntl(ctl_pipe[1], F_SETFD, FD_CLOEXEC);
+
+    // a pipe would make stdout fully buffered. flush every line instead so
+    // output isn't held back, or duplicated into forked children
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    while (1)
+    {
+        // wipe the buffer and arguments
+        memset(buffer, 0, sizeof(buffer));
+        memset(tokens, 0, sizeof(tokens));
+
+        drain_coprocs();
+        if (!read_line(buffer, stdin))
+            break;  // client hung up
+
+        token_cnt = tokenize(buffer, " ", tokens);
+        handle_request(token_cnt, tokens);
+
+        // all of the command's output is in the pipes before its status is
+        fflush(stdout);
+        if (write(ctl_pipe[1], &last_status, sizeof(last_status)) == -1)
+            break;  // relay is gone, so the client is too
+    }
+
+    exit_shell();
+}
+
+
+/**
+ * @brief Frame a session's output for its client, until the session exits.
+ * 
+ * The client receives a sequence of records, each a text header holding a
+ * tag and a payload length, then exactly that many payload bytes:
+ *     SERVE_STDOUT_TAG <len>\n<bytes>   output written to stdout
+ *     SERVE_STDERR_TAG <len>\n<bytes>   output written to stderr
+ *     SERVE_STATUS_TAG <len>\n<status>  a command finished, with this status
+ * 
+ * ! WARNING: This function never returns. The relay exits once the session
+ * ! closes the control pipe.
+ * 
+ * @param client_fd Connected socket for this client
+ * @param out_fd Read end of the session's stdout pipe
+ * @param err_fd Read end of the session's stderr pipe
+ * @param ctl_fd Read end of the pipe carrying exit statuses
+ */
+void relay_session_output(int client_fd, int out_fd, int err_fd, int ctl_fd)
+{
+    struct pollfd fds[3];
+    char status_str[MAX_LENGTH];
+    int status;
+    ssize_t n;
+
+    fcntl(out_fd, F_SETFL, O_NONBLOCK);
+    fcntl(err_fd, F_SETFL, O_NONBLOCK);
+    fds[0].fd = out_fd;
+    fds[1].fd = err_fd;
+    fds[2].fd = ctl_fd;
+    for (int i = 0; i < 3; i++)
+        fds[i].events = POLLIN;
+
+    while (1)
+    {
+        if (poll(fds, 3, -1) == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("poll() failed (session relay)");
+            break;
+        }
+
+        if (fds[0].revents != 0 &&
+            forward_output(client_fd, out_fd, SERVE_STDOUT_TAG) == 0)
+            fds[0].fd = -1;  // stdout closed for good. poll() skips it now
+        if (fds[1].revents != 0 &&
+            forward_output(client_fd, err_fd, SERVE_STDERR_TAG) == 0)
+            fds[1].fd = -1;
+
+        if (fds[2].revents != 0)
+        {
+            // the command has exited, so whatever it wrote is already
+            // waiting in the pipes. send that before its status
+            forward_output(client_fd, out_fd, SERVE_STDOUT_TAG);
+            forward_output(client_fd, err_fd, SERVE_STDERR_TAG);
+
+            n = read(ctl_fd, &status, sizeof(status));
+            if (n <= 0)
+                break;  // session has exited
+            snprintf(status_str, sizeof(status_str), "%d", status);
+            if (send_record(client_fd, SERVE_STATUS_TAG,
+                            status_str, strlen(status_str)) == -1)
+                break;
+        }
+    }
+
+    _exit(0);
+}
+
+
+/**
+ * @brief Forward everything currently waiting in a pipe to the client
+ * 
+ * @param client_fd Connected socket for this client
+ * @param fd Non-blocking read end of the pipe
+ * @param tag Record tag for this pipe's output
+ * 
+ * @return 0 if the pipe was closed (or the client is gone), 1 otherwise
+ */
+int forward_output(int client_fd, int fd, char tag)
+{
+    char buf[SERVE_RECORD_SIZE];
+    ssize_t n;
+
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+    {
+        if (send_record(client_fd, tag, buf, n) == -1)
+            _exit(1);  // client hung up, nobody left to relay to
+    }
+    return (n == -1 && (errno == EAGAIN || errno == EINTR));
+}
+
+
+/**
+ * @brief Send one framed record to the client
+ * 
+ * @param client_fd Connected socket for this client
+ * @param tag Record tag (eg. SERVE_STDOUT_TAG)
+ * @param payload Bytes to send
+ * @param len Number of bytes
+ * 
+ * @return 0 on success, -1 if the client can't be written to
+ */
+int send_record(int client_fd, char tag, const char *payload, size_t len)
+{
+    char header[MAX_LENGTH];
+    int header_len = snprintf(header, sizeof(header), "%c %zu\n", tag, len);
+
+    if (write_all(client_fd, header, header_len) == -1 ||
+        write_all(client_fd, payload, len) == -1)
+        return -1;
+    return 0;
+}
+
+
+/**
+ * @brief Write a whole buffer, retrying after partial writes
+ * 
+ * @param fd File descriptor to write to
+ * @param buf Bytes to write
+ * @param len Number of bytes
+ * 
+ * @return 0 on success, -1 on failure
+ */
+int write_all(int fd, const char *buf, size_t len)
+{
+    ssize_t n;
+    while (len > 0)
+    {
+        n = write(fd, buf, len);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n == -1)
+            return -1;
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+// server.h
+// Tawfeeq Mannan
+
+#ifndef _SERVER_H
+#define _SERVER_H
+
+#include <stddef.h>  // size_t
+
+
+/**
+ * @brief Accept clients on a Unix domain socket and run their commands,
+ *        with at most max_workers sessions running at the same time.
+ * 
+ * @param socket_path Filesystem path to bind the socket to
+ * @param max_workers Size of the session worker pool
+ * 
+ * @return Exit status (only returns if the socket could not be set up)
+ */
+int serve(const char *socket_path, int max_workers);
+
+
+/**
+ * @brief Create, bind and listen on a Unix domain socket.
+ *        Any stale socket file at the path is removed first.
+ * 
+ * @param socket_path Filesystem path to bind the socket to
+ * 
+ * @return Listening socket fd, or -1 on failure
+ */
+int open_server_socket(const char *socket_path);
+
+
+/**
+ * @brief Run one client's session in a worker process.
+ * 
+ * ! WARNING: This function never returns. The worker exits through
+ * ! exit_shell() once the client sends "exit" or closes its end.
+ * 
+ * @param client_fd Connected socket for this client
+ */
+void serve_session(int client_fd);
+
+
+/**
+ * @brief Frame a session's output for its client as tagged, length-prefixed
+ *        records, until the session exits.
+ * 
+ * ! WARNING: This function never returns. The relay exits once the session
+ * ! closes the control pipe.
+ * 
+ * @param client_fd Connected socket for this client
+ * @param out_fd Read end of the session's stdout pipe
+ * @param err_fd Read end of the session's stderr pipe
+ * @param ctl_fd Read end of the pipe carrying exit statuses
+ */
+void relay_session_output(int client_fd, int out_fd, int err_fd, int ctl_fd);
+
+
+/**
+ * @brief Forward everything currently waiting in a pipe to the client
+ * 
+ * @param client_fd Connected socket for this client
+ * @param fd Non-blocking read end of the pipe
+ * @param tag Record tag for this pipe's output
+ * 
+ * @return 0 if the pipe was closed, 1 otherwise
+ */
+int forward_output(int client_fd, int fd, char tag);
+
+
+/**
+ * @brief Send one framed record to the client
+ * 
+ * @param client_fd Connected socket for this client
+ * @param tag Record tag (eg. SERVE_STDOUT_TAG)
+ * @param payload Bytes to send
+ * @param len Number of bytes
+ * 
+ * @return 0 on success, -1 if the client can't be written to
+ */
+int send_record(int client_fd, char tag, const char *payload, size_t len);
+
+
+/**
+ * @brief Write a whole buffer, retrying after partial writes
+ * 
+ * @param fd File descriptor to write to
+ * @param buf Bytes to write
+ * @param len Number of bytes
+ * 
+ * @return 0 on success, -1 on failure
+ */
+int write_all(int fd, const char *buf, size_t len);
+
+
+#endif  // _SERVER_H
@@ -13,12 +13,31 @@
  * 
  * @param buffer char array to store the resulting input.
  *               Space must be pre-allocated for fgets().
+ * 
+ * @return 1 if a line was read, 0 on end of input
  */
-void display_prompt(char *buffer)
+int display_prompt(char *buffer)
 {
     printf("dragonshell > ");
-    fgets(buffer, LINE_LENGTH, stdin);
+    return read_line(buffer, stdin);
+}
+
+
+/**
+ * @brief Read a single line from a stream, stripping the trailing newline
+ * 
+ * @param buffer char array to store the resulting input.
+ *               Space must be pre-allocated for fgets().
+ * @param stream Stream to read from (eg. stdin)
+ * 
+ * @return 1 if a line was read, 0 on end of input
+ */
+int read_line(char *buffer, FILE *stream)
+{
+    if (fgets(buffer, LINE_LENGTH, stream) == NULL)
+        return 0;
     buffer[strcspn(buffer, "\n")] = '\0';
+    return 1;
 }
 
 
@@ -67,6 +86,39 @@ void log_error_msg(ErrCode rc)
     case EC_UNKNOWN_CMD:
         printf("dragonshell: Command not found\n");
         break;
+    case EC_BAD_ARG:
+        printf("dragonshell: Invalid argument\n");
+        break;
+    case EC_COPROC_NO_ARGS:
+        printf("dragonshell: Expected coprocess name (and command)\n");
+        break;
+    case EC_COPROC_NAME_LENGTH:
+        printf("dragonshell: Coprocess name is too long\n");
+        break;
+    case EC_COPROC_EXISTS:
+        printf("dragonshell: Coprocess is already running\n");
+        break;
+    case EC_COPROC_NOT_FOUND:
+        printf("dragonshell: No such coprocess\n");
+        break;
+    case EC_COPROC_LIMIT:
+        printf("dragonshell: Too many coprocesses\n");
+        break;
+    case EC_COPROC_FULL:
+        printf("dragonshell: Coprocess output is not being read\n");
+        break;
+    case EC_COPROC_TIMEOUT:
+        printf("dragonshell: Coprocess is not responding\n");
+        break;
+    case EC_COPROC_CLOSED:
+        printf("dragonshell: Coprocess has exited\n");
+        break;
+    case EC_TOO_MANY_JOBS:
+        printf("dragonshell: Too many background jobs, terminating job\n");
+        break;
+    case EC_SERVE_USAGE:
+        printf("Usage: dragonshell [--serve SOCKET [--workers N]]\n");
+        break;
     default:
         printf("dragonshell: Unknown error code!\n");
         printf("Ensure all errors have been added to enum ErrCode.\n");
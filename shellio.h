@@ -5,6 +5,7 @@
 #define _SHELLIO_H
 
 #include <stddef.h>  // size_t
+#include <stdio.h>   // FILE
 
 #include "constants.h"
 
@@ -13,8 +14,21 @@
  * @brief Print the prompt and take a line of user input
  * 
  * @param buffer char array to store user input. Space must be pre-allocated.
+ * 
+ * @return 1 if a line was read, 0 on end of input
+ */
+int display_prompt(char *buffer);
+
+
+/**
+ * @brief Read a single line from a stream, stripping the trailing newline
+ * 
+ * @param buffer char array to store the line. Space must be pre-allocated.
+ * @param stream Stream to read from (eg. stdin)
+ * 
+ * @return 1 if a line was read, 0 on end of input
  */
-void display_prompt(char *buffer);
+int read_line(char *buffer, FILE *stream);
 
 
 /**
@@ -0,0 +1,88 @@
+#!/bin/sh
+# bench.sh
+# Tawfeeq Mannan
+#
+# Times generated scripts fed through dragonshell, comparing a loop that
+# uses a shell feature against the same loop done with plain programs.
+#
+# Usage: test/bench.sh coproc|builtins [items]
+# Run from the project root after `make dragonshell`.
+
+DSH=${DSH:-./dragonshell}
+SCRIPT=$(mktemp)
+trap 'rm -f "$SCRIPT" "$SCRIPT.item"' EXIT
+
+# time_script LABEL ITEMS: run $SCRIPT through the shell, report per-item cost
+time_script()
+{
+    start=$(date +%s%N)
+    "$DSH" < "$SCRIPT" > /dev/null
+    end=$(date +%s%N)
+    total_us=$(( (end - start) / 1000 ))
+    printf '%-28s %8d us total %8d us/item\n' "$1" "$total_us" \
+        $(( total_us / $2 ))
+}
+
+bench_coproc()
+{
+    items=$1
+    sed=$(command -v sed)
+    echo "item" > "$SCRIPT.item"
+
+    # launch the filter once per item
+    i=0; : > "$SCRIPT"
+    while [ $i -lt "$items" ]; do
+        echo "$sed s/^/x/ $SCRIPT.item" >> "$SCRIPT"
+        i=$((i + 1))
+    done
+    echo "exit" >> "$SCRIPT"
+    time_script "filter launched per item" "$items"
+
+    # launch the filter once, then feed it every item
+    i=0; echo "coproc F $sed -u s/^/x/" > "$SCRIPT"
+    while [ $i -lt "$items" ]; do
+        printf 'cowrite F item\ncoread F\n' >> "$SCRIPT"
+        i=$((i + 1))
+    done
+    echo "exit" >> "$SCRIPT"
+    time_script "coproc filter" "$items"
+}
+
+# gen_loop ITEMS LINE: a script that runs LINE once per item
+gen_loop()
+{
+    i=0; : > "$SCRIPT"
+    while [ $i -lt "$1" ]; do
+        printf '%s\n' "$2" >> "$SCRIPT"
+        i=$((i + 1))
+    done
+    echo "exit" >> "$SCRIPT"
+}
+
+# prog NAME: full path of a program, skipping /bin/sh's own builtins
+prog()
+{
+    for dir in /bin /usr/bin; do
+        [ -x "$dir/$1" ] && { echo "$dir/$1"; return; }
+    done
+}
+
+bench_builtins()
+{
+    items=$1
+    for cmd in "echo hello" "printf %s-%d\\n a 1" "test 1 -lt 2" \
+               "true" "false"; do
+        name=${cmd%% *}
+        args=${cmd#"$name"}
+        gen_loop "$items" "$(prog "$name")$args"
+        time_script "$name (external)" "$items"
+        gen_loop "$items" "$cmd"
+        time_script "$name (builtin)" "$items"
+    done
+}
+
+case "$1" in
+    coproc) bench_coproc "${2:-1000}" ;;
+    builtins) bench_builtins "${2:-1000}" ;;
+    *) echo "Usage: $0 coproc|builtins [items]"; exit 1 ;;
+esac
@@ -0,0 +1,146 @@
+// bench_serve.c
+// Tawfeeq Mannan
+//
+// Load generator for `dragonshell --serve`. Opens many parallel sessions,
+// sends the same command repeatedly on each, and reports requests/second
+// along with the latency distribution.
+//
+// Usage: test/bench_serve SOCKET [sessions] [requests] [command]
+
+#define _POSIX_C_SOURCE 200809L  // needed for clock_gettime, fdopen
+#include <string.h>     // strlen, strncpy, memset
+#include <stdio.h>      // printf, fscanf, fread, fdopen
+#include <stdlib.h>     // atoi, malloc, qsort
+#include <unistd.h>     // fork, pipe, read, write, close
+#include <time.h>       // clock_gettime
+#include <sys/types.h>  // pid_t
+#include <sys/socket.h> // socket, connect
+#include <sys/un.h>     // sockaddr_un
+#include <sys/wait.h>   // wait
+
+#define STATUS_TAG 's'  // must match SERVE_STATUS_TAG
+
+
+double now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+
+int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+
+// reads "<tag> <len>\n<payload>" records up to and including a status record
+int skip_to_status(FILE *replies, char *buf, size_t size)
+{
+    char tag;
+    size_t len;
+
+    while (fscanf(replies, "%c %zu", &tag, &len) == 2 && fgetc(replies) == '\n')
+    {
+        if (len > size || fread(buf, 1, len, replies) != len)
+            return -1;
+        if (tag == STATUS_TAG)
+            return 0;
+    }
+    return -1;
+}
+
+
+// runs in its own process: one session, latencies written to report_fd
+int run_session(const char *path, int requests, const char *cmd, int report_fd)
+{
+    struct sockaddr_un addr;
+    char line[4096];
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (fd == -1 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1)
+    {
+        perror("connect() failed");
+        return 1;
+    }
+    FILE *replies = fdopen(fd, "r");
+
+    for (int i = 0; i < requests; i++)
+    {
+        double start = now_us();
+        if (write(fd, cmd, strlen(cmd)) == -1 || write(fd, "\n", 1) == -1)
+            return 1;
+        // skip output records until the status record arrives
+        if (skip_to_status(replies, line, sizeof(line)) == -1)
+            return 1;
+
+        double latency = now_us() - start;
+        if (write(report_fd, &latency, sizeof(latency)) == -1)
+            return 1;
+    }
+
+    fclose(replies);  // server reaps the session on hangup
+    return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s SOCKET [sessions] [requests] [command]\n", argv[0]);
+        return 1;
+    }
+    const char *path = argv[1];
+    int sessions = (argc >= 3) ? atoi(argv[2]) : 16;
+    int requests = (argc >= 4) ? atoi(argv[3]) : 1000;
+    const char *cmd = (argc >= 5) ? argv[4] : "pwd";
+
+    int report[2];
+    if (pipe(report) == -1)
+    {
+        perror("pipe() failed");
+        return 1;
+    }
+
+    double start = now_us();
+    for (int s = 0; s < sessions; s++)
+    {
+        if (fork() == 0)
+        {
+            close(report[0]);
+            _exit(run_session(path, requests, cmd, report[1]));
+        }
+    }
+    close(report[1]);
+
+    // collect every latency sample until all sessions close the pipe
+    size_t total = (size_t) sessions * requests, n = 0;
+    double *lat = malloc(total * sizeof(double));
+    while (n < total && read(report[0], &lat[n], sizeof(double)) == sizeof(double))
+        n++;
+    while (wait(NULL) > 0)
+        ;
+    double elapsed = now_us() - start;
+
+    if (n == 0)
+    {
+        printf("No requests completed\n");
+        return 1;
+    }
+    qsort(lat, n, sizeof(double), cmp_double);
+    printf("%d sessions x %d requests of \"%s\"\n", sessions, requests, cmd);
+    printf("completed: %zu / %zu\n", n, total);
+    printf("throughput: %.0f req/s\n", n / (elapsed / 1e6));
+    printf("latency us: p50 %.0f  p90 %.0f  p99 %.0f  p99.9 %.0f  max %.0f\n",
+           lat[n / 2], lat[n * 90 / 100], lat[n * 99 / 100],
+           lat[n * 999 / 1000], lat[n - 1]);
+
+    free(lat);
+    return 0;
+}